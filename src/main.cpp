@@ -1,15 +1,28 @@
 #include <algorithm>
 #include <assert.h>
 #include <atomic>
+#include <chrono>
 #include <complex>
 #include <mutex>
 #include <optional>
 #include <random>
 #include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
 #include <thread>
 #include <vector>
 
+#ifndef _WIN32
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
 #include "bmp.h"
 
 typedef double fp;
@@ -33,17 +46,48 @@ constexpr int max_period = 40;
 constexpr bool AA = true;
 constexpr int AA_samples = 20;
 constexpr int border_radius = 5;
-thread_local std::mt19937 rng;
-std::uniform_real_distribution<fp> ux(-dx/2, dx/2);
-std::uniform_real_distribution<fp> uy(-dy/2, dy/2);
+// sample offsets are a hash of the pixel and sample index, so a pixel always gets the same samples
+// no matter which thread or process renders it
+constexpr uint64_t AA_seed = 0;
+// wall-clock budget for a render in seconds, 0 for no limit. When it runs out anti-aliasing stops,
+// pixels which were not anti-aliased keep their plain color. Anti-aliasing is done in order of
+// visibility so the budget goes to the pixels where it matters most. In distributed mode that order
+// only holds within a band, each band gets an even share of the time left when it's handed out.
+constexpr fp time_budget = 0;
 
 // set the render mode
-enum class render_mode { brute_force, mariani };
+enum class render_mode { brute_force, mariani, distributed };
 constexpr render_mode mode = render_mode::mariani;
 
 // take escape time into account for mariani instead of just escaped or not escaped
 constexpr bool mariani_escape_time = true;
 
+// tile pipeline settings
+// the image is split into tiles which move independently through classification, coloring, edge
+// detection, and anti-aliasing
+constexpr int tile_size = 64;
+constexpr int tiles_x = cdiv(w, tile_size);
+constexpr int tiles_y = cdiv(h, tile_size);
+// radius, in tiles, which must be classified before a tile's edges can be detected
+constexpr int tile_halo = cdiv(border_radius, tile_size);
+
+// distributed settings
+// the coordinator splits the image into bands of rows which are rendered by worker processes
+constexpr int distributed_workers = 4;
+constexpr int band_height = 2 * tile_size;
+// Rows rendered around each band so anti-aliasing near band edges sees its surroundings. One
+// border_radius covers edges just outside the band seeding pixels inside it, the second covers a
+// frontier step from those seeds back into the band. The frontier can grow further than that so
+// longer chains crossing a band edge are cut off and seams are possible, though at the default
+// settings the output matches a local render exactly.
+constexpr int band_halo = 2 * border_radius;
+// times a band is retried before the render is abandoned
+constexpr int max_retries = 3;
+// seconds a worker gets to render a band before it's considered stuck and replaced
+constexpr int band_timeout = 10 * 60;
+// also send point descriptors back to the coordinator
+constexpr bool distributed_points = false;
+
 // show where mariani / AA is done
 constexpr bool debug_info = false;
 
@@ -82,6 +126,45 @@ atomic_optional<point_descriptor> points[w][h];
 bool ms_mask[w][h];
 bool aa_mask[w][h];
 
+// pipeline state
+enum class stage { classify, color, edge_detect, anti_alias };
+struct pipeline_job {
+	stage s;
+	// classify: box i, j, w, h
+	// color / edge_detect: tile i, j
+	// anti_alias: pixel i, j
+	int i, j, w, h;
+	// larger runs first
+	int priority;
+	bool operator<(const pipeline_job& other) const { return priority < other.priority; }
+};
+// everything other than anti-aliasing runs as soon as possible since it unblocks more work
+constexpr int stage_priority = std::numeric_limits<int>::max();
+using pipeline_queue = parallel_queue<pipeline_job, priority_queue<std::optional<pipeline_job>>>;
+struct tile_state {
+	// outstanding mariani-silver boxes, the tile is classified when this reaches zero
+	std::atomic_int pending_boxes = 1;
+	// tiles in the halo (including this one) which haven't been colored yet
+	std::atomic_int pending_neighbors = 0;
+	// anti-aliasing can reach a tile before it has been colored, those jobs are held here
+	std::mutex m;
+	bool colored = false;
+	std::vector<pipeline_job> deferred;
+};
+tile_state tiles[tiles_x][tiles_y];
+// area being rendered, a distributed worker only renders its band plus halo
+struct region { int x0, y0, x1, y1; };
+region bounds = {0, 0, w, h};
+// anti-aliasing stops at the deadline
+std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max();
+// anti-aliasing progress, reported when rendering on a time budget
+std::atomic_int aa_queued = 0;
+std::atomic_int aa_processed = 0;
+// rows counted towards progress, a distributed worker doesn't count its halo since neighboring
+// bands render it too
+int counted_y0 = 0;
+int counted_y1 = h;
+
 std::complex<fp> phi_n(int n, std::complex<fp> z, const std::complex<fp> c) {
 	while(n--) {
 		z = z * z + c;
@@ -176,11 +259,17 @@ pixel_t get_pixel(fp x, fp y) {
 	}
 }
 
-pixel_t sample(fp x, fp y) {
+pixel_t sample(int i, int j) {
+	let [x, y] = get_coordinates(i, j);
 	if(AA) {
+		// one 64-bit draw per sample, the high half is the x offset and the low half the y offset
+		let key = splitmix64(AA_seed ^ ((uint64_t)(uint32_t)i << 32 | (uint32_t)j));
 		int r = 0, g = 0, b = 0;
-		for(int i = 0; i < AA_samples; i++) {
-			let color = get_pixel(x + ux(rng), y + uy(rng));
+		for(int k = 0; k < AA_samples; k++) {
+			let bits = splitmix64(key + k);
+			let ox = ((fp)(bits >> 32) / 0x1p32 - 0.5) * dx;
+			let oy = ((fp)(bits & 0xffffffff) / 0x1p32 - 0.5) * dy;
+			let color = get_pixel(x + ox, y + oy);
 			r += color.r;
 			g += color.g;
 			b += color.b;
@@ -229,105 +318,591 @@ void brute_force_worker(std::atomic_int* xj, BMP* bmp, int id) {
 		if(id == 0) printf("\033[1K\r%0.2f%%", (fp)j / h * 100);
 		if(id == 0) fflush(stdout);
 		for(int i = 0; i < w; i++) {
-			let [x, y] = get_coordinates(i, j);
-			let color = sample(x, y);
+			let color = sample(i, j);
 			bmp->set(i, j, color);
 		}
 	}
 }
 
-void mariani_silver_worker(parallel_queue<std::tuple<int, int, int, int>>* _mq) {
-	parallel_queue<std::tuple<int, int, int, int>>& mq = *_mq;
-	while(let job = mq.pop()) {
-		let [i, j, w, h] = *job;
-		assert(w >= 0 && h >= 0);
-		if(w <= 4 || h <= 4) {
-			// an optimization but also handling an edge case where i + w/2 - 1 ==== i and cdiv(w, 2) + 1 ==== w
-			for(int x = i; x < i + w; x++) {
-				for(int y = j; y < j + h; y++) {
-					if(debug_info) ms_mask[x][y] = true;
-					points[x][y] = get_point(x, y);
-				}
+// Mariani-Silver step for a single box. Either fills the box or returns true if it needs to be
+// subdivided.
+bool mariani_silver_box(int i, int j, int w, int h) {
+	assert(w >= 0 && h >= 0);
+	if(w <= 4 || h <= 4) {
+		// an optimization but also handling an edge case where i + w/2 - 1 ==== i and cdiv(w, 2) + 1 ==== w
+		for(int x = i; x < i + w; x++) {
+			for(int y = j; y < j + h; y++) {
+				if(debug_info) ms_mask[x][y] = true;
+				points[x][y] = get_point(x, y);
 			}
-			continue;
 		}
-		std::optional<point_descriptor> pd;
-		bool all_same = true;
-		for(int x = i; x < i + w; x++) {
-			if(debug_info) ms_mask[x][j] = true;
-			if(debug_info) ms_mask[x][j + h - 1] = true;
-			let d1 = get_point(x, j);
-			let d2 = get_point(x, j + h - 1);
-			if(!pd.has_value()) pd = d1;
-			if(*pd != d1) all_same = false;
-			if(*pd != d2) all_same = false;
+		return false;
+	}
+	std::optional<point_descriptor> pd;
+	bool all_same = true;
+	for(int x = i; x < i + w; x++) {
+		if(debug_info) ms_mask[x][j] = true;
+		if(debug_info) ms_mask[x][j + h - 1] = true;
+		let d1 = get_point(x, j);
+		let d2 = get_point(x, j + h - 1);
+		if(!pd.has_value()) pd = d1;
+		if(*pd != d1) all_same = false;
+		if(*pd != d2) all_same = false;
+	}
+	for(int y = j; y < j + h; y++) {
+		if(debug_info) ms_mask[i][y] = true;
+		if(debug_info) ms_mask[i + w - 1][y] = true;
+		let d1 = get_point(i, y);
+		let d2 = get_point(i + w - 1, y);
+		if(!pd.has_value()) pd = d1;
+		if(*pd != d1) all_same = false;
+		if(*pd != d2) all_same = false;
+	}
+	assert(pd.has_value());
+	if(w > cdiv(::w, 2)) all_same = false; // fixme: hack
+	if(all_same) {
+		for(int x = i + 1; x < i + w - 1; x++) {
+			for(int y = j + 1; y < j + h - 1; y++) {
+				points[x][y] = *pd;
+			}
 		}
-		for(int y = j; y < j + h; y++) {
-			if(debug_info) ms_mask[i][y] = true;
-			if(debug_info) ms_mask[i + w - 1][y] = true;
-			let d1 = get_point(i, y);
-			let d2 = get_point(i + w - 1, y);
-			if(!pd.has_value()) pd = d1;
-			if(*pd != d1) all_same = false;
-			if(*pd != d2) all_same = false;
+		return false;
+	} else {
+		return true;
+	}
+}
+
+// pixels of a tile which are within the render bounds
+region tile_pixels(int tx, int ty) {
+	return {
+		std::max(bounds.x0, tx * tile_size), std::max(bounds.y0, ty * tile_size),
+		std::min(bounds.x1, (tx + 1) * tile_size), std::min(bounds.y1, (ty + 1) * tile_size)
+	};
+}
+
+// tiles overlapping the render bounds
+region tile_bounds() {
+	return {bounds.x0 / tile_size, bounds.y0 / tile_size, cdiv(bounds.x1, tile_size), cdiv(bounds.y1, tile_size)};
+}
+
+int color_distance(pixel_t a, pixel_t b) {
+	return std::abs(a.r - b.r) + std::abs(a.g - b.g) + std::abs(a.b - b.b);
+}
+
+// largest color difference between a point and its neighbors
+int local_contrast(int i, int j) {
+	let center = get_color(i, j);
+	int contrast = 0;
+	for(int x = std::max(bounds.x0, i - 1); x <= std::min(bounds.x1 - 1, i + 1); x++) {
+		for(int y = std::max(bounds.y0, j - 1); y <= std::min(bounds.y1 - 1, j + 1); y++) {
+			contrast = std::max(contrast, color_distance(center, get_color(x, y)));
 		}
-		assert(pd.has_value());
-		if(w > cdiv(::w, 2)) all_same = false; // fixme: hack
-		if(all_same) {
-			for(int x = i + 1; x < i + w - 1; x++) {
-				for(int y = j + 1; y < j + h - 1; y++) {
-					points[x][y] = *pd;
-				}
+	}
+	return contrast;
+}
+
+// true if the point is on the boundary between escaped and non-escaped points
+bool is_edge(int i, int j) {
+	bool center = points[i][j].value().escaped;
+	bool has_white = false;
+	bool has_non_white = false;
+	for(int x = std::max(bounds.x0, i - 1); x <= std::min(bounds.x1 - 1, i + 1); x++) {
+		for(int y = std::max(bounds.y0, j - 1); y <= std::min(bounds.y1 - 1, j + 1); y++) {
+			if(x == i && y == j) continue;
+			if(points[x][y].value().escaped) {
+				has_white = true;
+			} else {
+				has_non_white = true;
 			}
-		} else {
-			mq.lock();
-			mq.unsync_push(std::tuple<int, int, int, int> {i,           j,           w / 2,          h / 2         });
-			mq.unsync_push(std::tuple<int, int, int, int> {i + w/2 - 1, j,           cdiv(w, 2) + 1, h / 2         });
-			mq.unsync_push(std::tuple<int, int, int, int> {i,           j + h/2 - 1, w / 2,          cdiv(h, 2) + 1});
-			mq.unsync_push(std::tuple<int, int, int, int> {i + w/2 - 1, j + h/2 - 1, cdiv(w, 2) + 1, cdiv(h, 2) + 1});
-			mq.unlock();
+			if(has_white && has_non_white) goto b;
 		}
 	}
+	b:
+	return (center && has_non_white) || (!center && has_white);
 }
 
-void AA_worker(BMP* _bmp, parallel_queue<std::pair<int, int>>* _aaq, std::mutex* _maskmutex) {
-	auto T = std::tuple<BMP&, parallel_queue<std::pair<int, int>>&,  std::mutex&> { *_bmp, *_aaq, *_maskmutex };
-	auto& [bmp, aaq, maskmutex] = T;
-	while(let job = aaq.pop()) {
-		// Take a job and anti-alias the pixel
-		let [i, j] = *job;
-		let [x, y] = get_coordinates(i, j);
-		let p = sample(x, y);
-		if(p != bmp.get(i, j)) { // no lock needed for reading
-			// no lock needed because only this thread should ever write to this pixel
-			bmp.set(i, j, p);
-			// if anti-alias discovered new detail, queue neighboring pixels - mask ensures we don't
-			// queue a pixel multiple times.
-			maskmutex.lock();
-			for(int x = std::max(0, i - border_radius); x <= std::min(w - 1, i + border_radius); x++) {
-				for(int y = std::max(0, j - border_radius); y <= std::min(h - 1, j + border_radius); y++) {
-					if((x-i)*(x-i) + (y-j)*(y-j) > border_radius*border_radius) continue;
-					if(!aa_mask[x][y]) {
-						aaq.push({x, y});
-						aa_mask[x][y] = true;
-					}
-				}
+// Queue a pixel for anti-aliasing. If its tile hasn't been colored yet the job is held by the tile
+// until it is.
+void queue_anti_alias(pipeline_queue& q, int i, int j, int priority) {
+	let& tile = tiles[i / tile_size][j / tile_size];
+	if(j >= counted_y0 && j < counted_y1) aa_queued.fetch_add(1, std::memory_order_relaxed);
+	tile.m.lock();
+	if(tile.colored) {
+		q.push({stage::anti_alias, i, j, 1, 1, priority});
+	} else {
+		tile.deferred.push_back({stage::anti_alias, i, j, 1, 1, priority});
+	}
+	tile.m.unlock();
+}
+
+// Queue every pixel within border_radius of i, j which hasn't been queued before, closer pixels get
+// higher priority. Mask mutex must be held.
+void queue_anti_alias_region(pipeline_queue& q, int i, int j, int priority) {
+	for(int x = std::max(bounds.x0, i - border_radius); x <= std::min(bounds.x1 - 1, i + border_radius); x++) {
+		for(int y = std::max(bounds.y0, j - border_radius); y <= std::min(bounds.y1 - 1, j + border_radius); y++) {
+			if((x-i)*(x-i) + (y-j)*(y-j) > border_radius*border_radius) continue;
+			if(!aa_mask[x][y]) {
+				aa_mask[x][y] = true;
+				queue_anti_alias(q, x, y, priority - (x-i)*(x-i) - (y-j)*(y-j));
+			}
+		}
+	}
+}
+
+void classify_job(pipeline_queue& q, int i, int j, int w, int h) {
+	let tx = i / tile_size;
+	let ty = j / tile_size;
+	let& tile = tiles[tx][ty];
+	if(mariani_silver_box(i, j, w, h)) {
+		tile.pending_boxes.fetch_add(4, std::memory_order_relaxed);
+		q.lock();
+		q.unsync_push({stage::classify, i,           j,           w / 2,          h / 2,          stage_priority});
+		q.unsync_push({stage::classify, i + w/2 - 1, j,           cdiv(w, 2) + 1, h / 2,          stage_priority});
+		q.unsync_push({stage::classify, i,           j + h/2 - 1, w / 2,          cdiv(h, 2) + 1, stage_priority});
+		q.unsync_push({stage::classify, i + w/2 - 1, j + h/2 - 1, cdiv(w, 2) + 1, cdiv(h, 2) + 1, stage_priority});
+		q.unlock();
+	}
+	if(tile.pending_boxes.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+		q.push({stage::color, tx, ty, 0, 0, stage_priority});
+	}
+}
+
+void color_job(pipeline_queue& q, BMP& bmp, int tx, int ty) {
+	let [x0, y0, x1, y1] = tile_pixels(tx, ty);
+	for(int i = x0; i < x1; i++) {
+		for(int j = y0; j < y1; j++) {
+			bmp.set(i, j, get_color(i, j));
+		}
+	}
+	// release anti-aliasing work which reached this tile early
+	let& tile = tiles[tx][ty];
+	tile.m.lock();
+	tile.colored = true;
+	std::vector<pipeline_job> deferred;
+	std::swap(deferred, tile.deferred);
+	tile.m.unlock();
+	for(let& job : deferred) {
+		q.push(job);
+	}
+	if(!AA) return;
+	// edge detection for a tile can start once every tile in its halo has been classified
+	let tb = tile_bounds();
+	for(int x = std::max(tb.x0, tx - tile_halo); x <= std::min(tb.x1 - 1, tx + tile_halo); x++) {
+		for(int y = std::max(tb.y0, ty - tile_halo); y <= std::min(tb.y1 - 1, ty + tile_halo); y++) {
+			if(tiles[x][y].pending_neighbors.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+				q.push({stage::edge_detect, x, y, 0, 0, stage_priority});
+			}
+		}
+	}
+}
+
+void edge_detect_job(pipeline_queue& q, std::mutex& maskmutex, int tx, int ty) {
+	let [x0, y0, x1, y1] = tile_pixels(tx, ty);
+	for(int i = x0; i < x1; i++) {
+		for(int j = y0; j < y1; j++) {
+			if(is_edge(i, j)) {
+				let contrast = local_contrast(i, j);
+				maskmutex.lock(); // todo: note: very small critical section - put mutex outside of loop?
+				queue_anti_alias_region(q, i, j, contrast);
+				maskmutex.unlock();
+			}
+		}
+	}
+}
+
+void anti_alias_job(pipeline_queue& q, BMP& bmp, std::mutex& maskmutex, int i, int j) {
+	// Out of time, leave the pixel as it is
+	if(time_budget > 0 && std::chrono::steady_clock::now() >= deadline) return;
+	if(j >= counted_y0 && j < counted_y1) aa_processed.fetch_add(1, std::memory_order_relaxed);
+	// Anti-alias the pixel
+	let p = sample(i, j);
+	let old = bmp.get(i, j); // no lock needed for reading
+	if(p != old) {
+		// no lock needed because only this thread should ever write to this pixel
+		bmp.set(i, j, p);
+		// if anti-alias discovered new detail, queue neighboring pixels - mask ensures we don't
+		// queue a pixel multiple times. The more the samples disagreed with the pixel's color the
+		// sooner the neighbors are looked at.
+		maskmutex.lock();
+		queue_anti_alias_region(q, i, j, color_distance(p, old));
+		maskmutex.unlock();
+	}
+}
+
+void pipeline_worker(BMP* _bmp, pipeline_queue* _q, std::mutex* _maskmutex) {
+	auto T = std::tuple<BMP&, pipeline_queue&,  std::mutex&> { *_bmp, *_q, *_maskmutex };
+	auto& [bmp, q, maskmutex] = T;
+	while(let job = q.pop()) {
+		[[maybe_unused]] let [s, i, j, w, h, priority] = *job;
+		switch(s) {
+			case stage::classify:
+				classify_job(q, i, j, w, h);
+				break;
+			case stage::color:
+				color_job(q, bmp, i, j);
+				break;
+			case stage::edge_detect:
+				edge_detect_job(q, maskmutex, i, j);
+				break;
+			case stage::anti_alias:
+				anti_alias_job(q, bmp, maskmutex, i, j);
+				break;
+		}
+	}
+}
+
+// Runs the tile pipeline over the current render bounds. State from a previous render of the same
+// area is cleared first so a process can render several regions.
+void render_tiles(BMP& bmp, int nthreads) {
+	for(int i = bounds.x0; i < bounds.x1; i++) {
+		for(int j = bounds.y0; j < bounds.y1; j++) {
+			points[i][j].clear();
+			ms_mask[i][j] = false;
+			aa_mask[i][j] = false;
+		}
+	}
+	aa_queued = 0;
+	aa_processed = 0;
+	pipeline_queue q(nthreads);
+	std::mutex maskmutex;
+	let tb = tile_bounds();
+	for(int tx = tb.x0; tx < tb.x1; tx++) {
+		for(int ty = tb.y0; ty < tb.y1; ty++) {
+			let& tile = tiles[tx][ty];
+			let neighbors = (std::min(tb.x1 - 1, tx + tile_halo) - std::max(tb.x0, tx - tile_halo) + 1)
+			              * (std::min(tb.y1 - 1, ty + tile_halo) - std::max(tb.y0, ty - tile_halo) + 1);
+			tile.pending_boxes = 1;
+			tile.pending_neighbors = neighbors;
+			tile.colored = false;
+			tile.deferred.clear();
+			let [x0, y0, x1, y1] = tile_pixels(tx, ty);
+			q.unsync_push({stage::classify, x0, y0, x1 - x0, y1 - y0, stage_priority});
+		}
+	}
+	std::vector<std::thread> thread_pool(nthreads);
+	for(let& t : thread_pool) {
+		t = std::thread(pipeline_worker, &bmp, &q, &maskmutex);
+	}
+	for(let& t : thread_pool) {
+		t.join();
+	}
+}
+
+#ifndef _WIN32
+// Distributed rendering:
+//   The coordinator splits the image into bands and hands them to worker processes over pipes.
+//   Workers are this executable re-run with --worker, they render a band plus a halo with the tile
+//   pipeline and send back the band's pixels (and optionally point descriptors).
+// Both sides are the same binary so structs are sent as-is.
+struct band_request {
+	int32_t y0, y1;
+	// steady_clock is system-wide so the coordinator's deadline means the same thing to workers
+	int64_t deadline;
+};
+
+struct band_response {
+	int32_t y0, y1;
+	// anti-aliasing progress within the band
+	int32_t aa_queued, aa_processed;
+};
+
+struct worker_process {
+	pid_t pid;
+	int in, out; // worker's stdin and stdout
+};
+
+struct band_job {
+	int y0, y1;
+	int attempts;
+};
+
+// returns false on eof or error
+bool read_all(int fd, void* buffer, std::size_t size) {
+	let* p = (char*)buffer;
+	while(size > 0) {
+		let n = read(fd, p, size);
+		if(n < 0 && errno == EINTR) continue;
+		if(n <= 0) return false;
+		p += n;
+		size -= n;
+	}
+	return true;
+}
+
+// set when a band can't be rendered, the other coordinators stop as soon as they notice
+std::atomic_bool distributed_failed = false;
+
+// read_all which gives up at `until` or once the distributed render has failed
+bool read_all_until(int fd, void* buffer, std::size_t size, std::chrono::steady_clock::time_point until) {
+	let* p = (char*)buffer;
+	while(size > 0) {
+		if(distributed_failed.load(std::memory_order_relaxed)) return false;
+		let remaining = std::chrono::duration_cast<std::chrono::milliseconds>(until - std::chrono::steady_clock::now()).count();
+		if(remaining <= 0) return false;
+		pollfd pfd { fd, POLLIN, 0 };
+		// wake up periodically to check for failure
+		let r = poll(&pfd, 1, (int)std::min<decltype(remaining)>(remaining, 100));
+		if(r < 0 && errno == EINTR) continue;
+		if(r < 0) return false;
+		if(r == 0) continue;
+		let n = read(fd, p, size);
+		if(n < 0 && errno == EINTR) continue;
+		if(n <= 0) return false;
+		p += n;
+		size -= n;
+	}
+	return true;
+}
+
+bool write_all(int fd, const void* buffer, std::size_t size) {
+	let* p = (const char*)buffer;
+	while(size > 0) {
+		let n = write(fd, p, size);
+		if(n < 0 && errno == EINTR) continue;
+		if(n <= 0) return false;
+		p += n;
+		size -= n;
+	}
+	return true;
+}
+
+// path workers are exec'd from, set by main
+const char* worker_executable;
+// held while pipes are created and workers forked, see spawn_worker
+std::mutex spawnmutex;
+
+// Makes a pipe whose ends are closed on exec. Without this workers would inherit each other's pipes
+// and closing a worker's stdin would never reach it as eof.
+bool cloexec_pipe(int fds[2]) {
+	if(pipe(fds) != 0) return false;
+	if(fcntl(fds[0], F_SETFD, FD_CLOEXEC) != 0 || fcntl(fds[1], F_SETFD, FD_CLOEXEC) != 0) {
+		close(fds[0]);
+		close(fds[1]);
+		return false;
+	}
+	return true;
+}
+
+std::optional<worker_process> spawn_worker(int nthreads) {
+	// The child may only make async-signal-safe calls between fork and exec (another thread could
+	// hold the malloc lock), so the arguments are built up front.
+	let threads = std::to_string(nthreads);
+	const char* args[] = { worker_executable, "--worker", threads.c_str(), nullptr };
+	// pipe + fcntl isn't atomic, another thread forking in between would leak these pipes
+	std::unique_lock<std::mutex> lock(spawnmutex);
+	int to_worker[2];
+	int from_worker[2];
+	if(!cloexec_pipe(to_worker)) return {};
+	if(!cloexec_pipe(from_worker)) {
+		close(to_worker[0]);
+		close(to_worker[1]);
+		return {};
+	}
+	let pid = fork();
+	if(pid == 0) {
+		dup2(to_worker[0], STDIN_FILENO);
+		dup2(from_worker[1], STDOUT_FILENO);
+		for(int fd : {to_worker[0], to_worker[1], from_worker[0], from_worker[1]}) close(fd);
+		execv(worker_executable, (char* const*)args);
+		_exit(127);
+	}
+	close(to_worker[0]);
+	close(from_worker[1]);
+	if(pid < 0) {
+		close(to_worker[1]);
+		close(from_worker[0]);
+		return {};
+	}
+	return worker_process { pid, to_worker[1], from_worker[0] };
+}
+
+void stop_worker(worker_process& worker, bool kill_worker) {
+	close(worker.in); // eof tells a healthy worker to exit
+	close(worker.out);
+	if(kill_worker) kill(worker.pid, SIGKILL);
+	waitpid(worker.pid, nullptr, 0);
+}
+
+// Sends one band to a worker and merges the result, returns false if the worker failed or took
+// longer than band_timeout
+bool render_band(worker_process& worker, BMP& bmp, int y0, int y1, std::chrono::steady_clock::time_point aa_deadline) {
+	let until = std::chrono::steady_clock::now() + std::chrono::seconds(band_timeout);
+	band_request request { y0, y1, aa_deadline.time_since_epoch().count() };
+	if(!write_all(worker.in, &request, sizeof(request))) return false;
+	band_response response;
+	if(!read_all_until(worker.out, &response, sizeof(response), until)) return false;
+	if(response.y0 != y0 || response.y1 != y1) return false;
+	std::vector<pixel_t> pixels((std::size_t)w * (y1 - y0));
+	if(!read_all_until(worker.out, pixels.data(), pixels.size() * sizeof(pixel_t), until)) return false;
+	std::vector<point_descriptor> descriptors;
+	if(distributed_points) {
+		descriptors.resize(pixels.size(), {false, 0, 0});
+		if(!read_all_until(worker.out, descriptors.data(), descriptors.size() * sizeof(point_descriptor), until)) return false;
+	}
+	// everything arrived, merge
+	for(int j = y0; j < y1; j++) {
+		for(int i = 0; i < w; i++) {
+			let k = (std::size_t)(j - y0) * w + i;
+			bmp.set(i, j, pixels[k]);
+			if(distributed_points) points[i][j] = descriptors[k];
+		}
+	}
+	aa_queued.fetch_add(response.aa_queued, std::memory_order_relaxed);
+	aa_processed.fetch_add(response.aa_processed, std::memory_order_relaxed);
+	return true;
+}
+
+// Anti-aliasing deadline for a band. Priority order only applies within a band so with one shared
+// deadline bands handed out late would get little or no anti-aliasing, instead each band gets an
+// even share of the time left.
+std::chrono::steady_clock::time_point band_deadline(int remaining_bands) {
+	let now = std::chrono::steady_clock::now();
+	if(time_budget <= 0 || now >= deadline) return deadline;
+	// bands are rendered distributed_workers at a time
+	let rounds = cdiv(remaining_bands, distributed_workers);
+	return now + (deadline - now) / rounds;
+}
+
+void coordinator_worker(BMP* _bmp, std::vector<band_job>* _bands, std::mutex* _bandmutex, std::atomic_int* done, int nthreads) {
+	auto T = std::tuple<BMP&, std::vector<band_job>&, std::mutex&> { *_bmp, *_bands, *_bandmutex };
+	auto& [bmp, bands, bandmutex] = T;
+	std::optional<worker_process> worker;
+	while(!distributed_failed.load(std::memory_order_relaxed)) {
+		bandmutex.lock();
+		if(bands.empty()) {
+			bandmutex.unlock();
+			break;
+		}
+		let job = bands.back();
+		bands.pop_back();
+		let remaining = (int)bands.size() + 1;
+		bandmutex.unlock();
+		if(!worker) worker = spawn_worker(nthreads);
+		if(worker && render_band(*worker, bmp, job.y0, job.y1, band_deadline(remaining))) {
+			let n = done->fetch_add(1, std::memory_order_relaxed) + 1;
+			printf("\033[1K\r%0.2f%%", (fp)n / cdiv(h, band_height) * 100);
+			fflush(stdout);
+			continue;
+		}
+		// another coordinator gave up
+		if(distributed_failed.load(std::memory_order_relaxed)) break;
+		// the worker died, stalled, or sent garbage, replace it and retry the band
+		if(worker) {
+			stop_worker(*worker, true);
+			worker.reset();
+		}
+		if(job.attempts + 1 > max_retries) {
+			fprintf(stderr, "\nband %d-%d failed %d times, giving up\n", job.y0, job.y1, job.attempts + 1);
+			distributed_failed = true;
+			break;
+		}
+		fprintf(stderr, "\nband %d-%d failed, retrying\n", job.y0, job.y1);
+		bandmutex.lock();
+		bands.push_back({job.y0, job.y1, job.attempts + 1});
+		bandmutex.unlock();
+	}
+	// workers may be mid-band if the render failed
+	if(worker) stop_worker(*worker, distributed_failed.load());
+}
+
+// returns false if a band couldn't be rendered
+bool render_distributed(BMP& bmp, int nthreads) {
+	// a dead worker shouldn't take the coordinator down with it
+	signal(SIGPIPE, SIG_IGN);
+	std::vector<band_job> bands;
+	for(int y = 0; y < h; y += band_height) {
+		bands.push_back({y, std::min(h, y + band_height), 0});
+	}
+	std::reverse(bands.begin(), bands.end()); // bands are taken from the back
+	std::mutex bandmutex;
+	std::atomic_int done = 0;
+	let worker_threads = std::max(1, nthreads / distributed_workers);
+	std::vector<std::thread> coordinators(distributed_workers);
+	for(let& t : coordinators) {
+		t = std::thread(coordinator_worker, &bmp, &bands, &bandmutex, &done, worker_threads);
+	}
+	for(let& t : coordinators) {
+		t.join();
+	}
+	return !distributed_failed.load();
+}
+
+// Worker process: renders bands requested on stdin until eof
+int worker_main(int nthreads) {
+	// stdout is the result channel, anything else printed goes to stderr
+	let out = dup(STDOUT_FILENO);
+	dup2(STDERR_FILENO, STDOUT_FILENO);
+	BMP bmp = BMP(w, h);
+	band_request request;
+	while(read_all(STDIN_FILENO, &request, sizeof(request))) {
+		if(request.y0 < 0 || request.y1 > h || request.y0 >= request.y1) return 1;
+		bounds = {0, std::max(0, request.y0 - band_halo), w, std::min(h, request.y1 + band_halo)};
+		counted_y0 = request.y0;
+		counted_y1 = request.y1;
+		deadline = std::chrono::steady_clock::time_point(std::chrono::steady_clock::duration(request.deadline));
+		render_tiles(bmp, nthreads);
+		std::vector<pixel_t> pixels;
+		std::vector<point_descriptor> descriptors;
+		for(int j = request.y0; j < request.y1; j++) {
+			for(int i = 0; i < w; i++) {
+				pixels.push_back(bmp.get(i, j));
+				if(distributed_points) descriptors.push_back(*points[i][j]);
 			}
-			maskmutex.unlock();
+		}
+		band_response response { request.y0, request.y1, aa_queued, aa_processed };
+		if(!write_all(out, &response, sizeof(response))) return 1;
+		if(!write_all(out, pixels.data(), pixels.size() * sizeof(pixel_t))) return 1;
+		if(distributed_points) {
+			if(!write_all(out, descriptors.data(), descriptors.size() * sizeof(point_descriptor))) return 1;
 		}
 	}
+	return 0;
 }
+#else
+static_assert(mode != render_mode::distributed, "distributed rendering needs fork / exec");
+#endif
 
-int main() {
+void report_aa_progress() {
+	let queued = aa_queued.load();
+	let processed = aa_processed.load();
+	printf("anti-aliased %d of %d queued pixels (%0.2f%%) within the time budget\n",
+	       processed, queued, queued == 0 ? 100. : (fp)processed / queued * 100);
+}
+
+int main(int argc, char** argv) {
 	assert(byte_swap(0x11223344) == 0x44332211);
 	assert(byte_swap(pixel_t{0x11, 0x22, 0x33}) == (pixel_t{0x33, 0x22, 0x11}));
-	// Render pipeline:
-	//   Mariani-silver figures out the mandelbrot main-body (multi-producer multi-consumer thread pool)
+	#ifndef _WIN32
+	if(argc == 3 && strcmp(argv[1], "--worker") == 0) {
+		return worker_main(std::max(1, atoi(argv[2])));
+	}
+	// argv[0] is only a usable path when the program wasn't found through PATH
+	#ifdef __linux__
+	worker_executable = "/proc/self/exe";
+	#else
+	worker_executable = argv[0];
+	#endif
+	#else
+	(void)argc;
+	(void)argv;
+	#endif
+	// Render pipeline, per tile:
+	//   Mariani-silver figures out the mandelbrot main-body
 	//   Color translation
-	//   Edge detection / Exploratory anti-aliasing pass (multi-producer multi-consumer thread pool)
+	//   Edge detection, once the tile's halo is classified
+	//   Exploratory anti-aliasing pass
+	// Every tile moves through these stages independently on one multi-producer multi-consumer
+	// thread pool, so there are no barriers between stages.
 	BMP bmp = BMP(w, h);
 	const int nthreads = std::thread::hardware_concurrency();
 	printf("parallel on %d threads\n", nthreads);
+	if(time_budget > 0 && mode == render_mode::brute_force) {
+		puts("warning: time budget is ignored when brute forcing");
+	} else if(time_budget > 0) {
+		printf("time budget %0.2fs\n", time_budget);
+		deadline = std::chrono::steady_clock::now()
+		         + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<fp>(time_budget));
+	}
 	if(mode == render_mode::brute_force) {
 		puts("starting brute force");
 		std::vector<std::thread> vec(nthreads);
@@ -339,74 +914,21 @@ int main() {
 			t.join();
 		}
 		puts("\033[1K\rfinished");
-	} else {
-		puts("starting mariani-silver");
-		parallel_queue<std::tuple<int, int, int, int>> mq(nthreads);
-		mq.unsync_push({0, 0, w, h});
-		std::vector<std::thread> thread_pool(nthreads);
-		for(let& t : thread_pool) {
-			t = std::thread(mariani_silver_worker, &mq);
-		}
-		for(let& t : thread_pool) {
-			t.join();
-		}
-		puts("finished mariani-silver, starting color translation");
-		// this could be folded into mariani-silver but it's super fast so it does not matter
-		for(int i = 0; i < w; i++) {
-			for(int j = 0; j < h; j++) {
-				bmp.set(i, j, get_color(i, j));
-			}
-		}
-		puts("finished color translation");
-		if(AA) {
-			puts("anti-alias enabled, starting anti-alias");
-			parallel_queue<std::pair<int, int>> aaq(nthreads + 1); // +1 for main
-			std::mutex maskmutex;
-			for(let& t : thread_pool) {
-				t = std::thread(AA_worker, &bmp, &aaq, &maskmutex);
-			}
-			for(int i = 0; i < w; i++) {
-				for(int j = 0; j < h; j++) {
-					bool center = points[i][j].value().escaped;
-					bool has_white = false;
-					bool has_non_white = false;
-					for(int x = std::max(0, i - 1); x <= std::min(w - 1, i + 1); x++) {
-						for(int y = std::max(0, j - 1); y <= std::min(h - 1, j + 1); y++) {
-							if(x == i && y == j) continue;
-							if(points[x][y].value().escaped) {
-								has_white = true;
-							} else {
-								has_non_white = true;
-							}
-							if(has_white && has_non_white) goto b;
-						}
-					}
-					b:
-					if((center && has_non_white) || (!center && has_white)) {
-						maskmutex.lock(); // todo: note: very small critical section - put mutex outside of loop?
-						for(int x = std::max(0, i - border_radius); x <= std::min(w - 1, i + border_radius); x++) {
-							for(int y = std::max(0, j - border_radius); y <= std::min(h - 1, j + border_radius); y++) {
-								if((x-i)*(x-i) + (y-j)*(y-j) > border_radius*border_radius) continue;
-								bool do_add = false;
-								if(!aa_mask[x][y]) {
-									do_add = true;
-									aa_mask[x][y] = true;
-								}
-								if(do_add) {
-									aaq.push({x, y});
-								}
-							}
-						}
-						maskmutex.unlock();
-					}
-				}
-			}
-			aaq.extern_post();
-			for(let& t : thread_pool) {
-				t.join();
-			}
-			puts("finished");
+	} else if(mode == render_mode::distributed) {
+		#ifndef _WIN32
+		printf("starting distributed render on %d workers\n", distributed_workers);
+		if(!render_distributed(bmp, nthreads)) {
+			fputs("distributed render failed\n", stderr);
+			return 1;
 		}
+		puts("\033[1K\rfinished");
+		if(time_budget > 0) report_aa_progress();
+		#endif
+	} else {
+		puts("starting tile pipeline");
+		render_tiles(bmp, nthreads);
+		puts("finished");
+		if(time_budget > 0) report_aa_progress();
 		if(debug_info) {
 			for(int i = 0; i < w; i++) {
 				for(int j = 0; j < h; j++) {
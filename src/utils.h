@@ -4,6 +4,7 @@
 #include <assert.h>
 #include <atomic>
 #include <condition_variable>
+#include <cstdint>
 #include <limits>
 #include <math.h>
 #include <mutex>
@@ -63,18 +64,36 @@ inline std::tuple<uint8_t, uint8_t, uint8_t> hsl_to_rgb(float h, float s, float
 	return {round(r * 255), round(g * 255), round(b * 255)};
 }
 
+// splitmix64 mixing function, used as a stateless counter-based generator: hashing a key plus a
+// counter gives a well distributed 64-bit value without any generator state
+// http://xoshiro.di.unimi.it/splitmix64.c
+constexpr uint64_t splitmix64(uint64_t x) {
+	x += 0x9e3779b97f4a7c15;
+	x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9;
+	x = (x ^ (x >> 27)) * 0x94d049bb133111eb;
+	return x ^ (x >> 31);
+}
+
 // ceiling division
-template<typename T> T cdiv(T x, T y) {
+template<typename T> constexpr T cdiv(T x, T y) {
 	return (x + y - 1) / y;
 }
 
+// std::priority_queue with std::queue's front() so it can back a parallel_queue, largest item first
+template<typename T> struct priority_queue : std::priority_queue<T> {
+	const T& front() const {
+		return this->top();
+	}
+};
+
 /*
  * This is a parallel queue designed for multi-producer multi-consumer systems. The parameter `n`
  * Represents the number of producers + consumers. The queue will be populated with `n` optional
- * none entries when all producers and consumers finish.
+ * none entries when all producers and consumers finish. `Q` can be a priority_queue to pop the
+ * largest item first instead of the oldest.
  */
-template<typename T> struct parallel_queue {
-	std::queue<std::optional<T>> q;
+template<typename T, typename Q = std::queue<std::optional<T>>> struct parallel_queue {
+	Q q;
 	std::mutex m;
 	std::condition_variable not_empty;
 	const int initial_count;
@@ -166,7 +185,10 @@ template<typename T> struct atomic_optional {
 		return item;
 	}
 	//const T&& take() {}
-	//void clear()
+	void clear() {
+		if(_has_value.load(std::memory_order_acquire)) item.~T();
+		_has_value.store(false, std::memory_order_release);
+	}
 	void operator=(T _item) {
 		if(_has_value.load(std::memory_order_acquire)) item.~T();
 		new (&item) T(_item);